@@ -0,0 +1,146 @@
+/*********************************************************************
+ * @file      BoundedQueue.h
+ * @brief     Fixed capacity lock-free queue used to connect the stages of
+ *              the image pipeline.
+ *
+ * @details   Any number of threads may push and pop concurrently. Each slot
+ *              carries a sequence number that tells producers when it is free
+ *              and consumers when it is filled, so neither side takes a lock.
+ *            push and pop wait while the queue is full or empty, which gives
+ *              the pipeline backpressure: a fast stage stalls instead of
+ *              piling up work for a slow one.
+ *********************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+template <typename T>
+class BoundedQueue {
+public:
+
+  /**
+   * @brief Constructor creates an empty queue
+   *
+   * @param capacity number of items the queue can hold, rounded up to a power
+   *          of two of at least 2 (with one slot a filled slot and a free
+   *          slot of the next lap would have the same sequence number)
+   */
+  explicit BoundedQueue(size_t capacity) : enqueue_pos(0), dequeue_pos(0) {
+    size_t size = 2;
+    while (size < capacity) {
+      size *= 2;
+    }
+    cells = std::vector<Cell>(size);
+    mask = size - 1;
+    for (size_t i = 0; i < size; ++i) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Adds value to the back of the queue if there is room
+   *
+   * @param value item to add
+   * @return true if value was added, false if the queue is full
+   */
+  bool tryPush(const T& value) {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = cells[pos & mask];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      ptrdiff_t diff = (ptrdiff_t)sequence - (ptrdiff_t)pos;
+
+      if (diff == 0) {
+
+        // Slot is free, claim it
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+
+        // Slot still holds an item from the previous lap, queue is full
+        return false;
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * @brief Removes the front item of the queue if there is one
+   *
+   * @param value receives the removed item
+   * @return true if an item was removed, false if the queue is empty
+   */
+  bool tryPop(T& value) {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = cells[pos & mask];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      ptrdiff_t diff = (ptrdiff_t)sequence - (ptrdiff_t)(pos + 1);
+
+      if (diff == 0) {
+
+        // Slot is filled, claim it
+        if (dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          value = cell.value;
+          cell.sequence.store(pos + mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+
+        // Slot has not been filled yet, queue is empty
+        return false;
+      } else {
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * @brief Adds value to the back of the queue, waiting while it is full
+   *
+   * @param value item to add
+   */
+  void push(const T& value) {
+    while (!tryPush(value)) {
+      std::this_thread::yield();
+    }
+  }
+
+  /**
+   * @brief Removes the front item of the queue, waiting while it is empty
+   *
+   * @return the removed item
+   */
+  T pop() {
+    T value;
+    while (!tryPop(value)) {
+      std::this_thread::yield();
+    }
+    return value;
+  }
+
+private:
+
+  // One slot of the ring buffer
+  struct Cell {
+    std::atomic<size_t> sequence; // lap and position the slot is ready for
+    T value;                      // stored item
+  };
+
+  std::vector<Cell> cells; // ring buffer, size is a power of two
+  size_t mask;             // size - 1, maps positions to slots
+
+  // Producer and consumer positions on separate cache lines
+  alignas(64) std::atomic<size_t> enqueue_pos;
+  alignas(64) std::atomic<size_t> dequeue_pos;
+};
@@ -0,0 +1,599 @@
+/*********************************************************************
+ * @file      GifCodec.cpp
+ * @brief     Implementation of the GIF reader and writer declared in
+ *              GifCodec.h.
+ *
+ * @details   Only what Image needs is supported: the first image of a file is
+ *              read, extensions are skipped, and images are written as a
+ *              single GIF87a frame with a 256 entry global palette.
+ *********************************************************************/
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+#include "GifCodec.h"
+
+/**
+ * @brief Largest number of LZW codes, GIF codes are at most 12 bits
+ */
+const int GIF_MAX_CODES = 4096;
+
+/**
+ * @brief Size of the buffer GIF files are written through
+ */
+const size_t GIF_OUTPUT_BUFFER_BYTES = 1 << 20;
+
+/**
+ * @brief Largest LZW data sub-block
+ */
+const int GIF_SUB_BLOCK_BYTES = 255;
+
+/**
+ * @brief GifOutput writes a file through a large buffer
+ */
+class GifOutput {
+public:
+
+  // Constructor opens filename for writing
+  explicit GifOutput(const string& filename)
+    : out(filename.c_str(), ios::binary), buffer(GIF_OUTPUT_BUFFER_BYTES),
+      used(0) {
+  }
+
+  // Returns true if no write has failed
+  bool good() const {
+    return out.good();
+  }
+
+  // Appends one byte
+  void put(unsigned char value) {
+    if (used == buffer.size()) {
+      flush();
+    }
+    buffer[used++] = value;
+  }
+
+  // Appends count bytes
+  void write(const unsigned char* data, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      put(data[i]);
+    }
+  }
+
+  // Appends a little endian 16 bit value
+  void putShort(int value) {
+    put((unsigned char)(value & 0xFF));
+    put((unsigned char)((value >> 8) & 0xFF));
+  }
+
+  // Writes the buffered bytes to the file
+  void flush() {
+    out.write(reinterpret_cast<const char*>(buffer.data()), used);
+    used = 0;
+  }
+
+private:
+  ofstream out;                  // destination file
+  vector<unsigned char> buffer;  // bytes not yet written
+  size_t used;                   // number of bytes in buffer
+};
+
+/**
+ * @brief LzwCodeWriter packs variable width codes LSB first into GIF data
+ *          sub-blocks.
+ */
+class LzwCodeWriter {
+public:
+
+  // Constructor writes sub-blocks to output
+  explicit LzwCodeWriter(GifOutput& output)
+    : output(output), bit_buffer(0), bit_count(0), block_used(0) {
+  }
+
+  // Appends code using width bits
+  void write(int code, int width) {
+    bit_buffer |= (uint32_t)code << bit_count;
+    bit_count += width;
+    while (bit_count >= 8) {
+      putByte((unsigned char)(bit_buffer & 0xFF));
+      bit_buffer >>= 8;
+      bit_count -= 8;
+    }
+  }
+
+  // Writes the remaining bits and the block terminator
+  void finish() {
+    if (bit_count > 0) {
+      putByte((unsigned char)(bit_buffer & 0xFF));
+    }
+    flushBlock();
+    output.put(0);
+  }
+
+private:
+
+  // Adds a byte to the current sub-block
+  void putByte(unsigned char value) {
+    block[block_used++] = value;
+    if (block_used == GIF_SUB_BLOCK_BYTES) {
+      flushBlock();
+    }
+  }
+
+  // Writes the current sub-block with its length prefix
+  void flushBlock() {
+    if (block_used > 0) {
+      output.put((unsigned char)block_used);
+      output.write(block, block_used);
+      block_used = 0;
+    }
+  }
+
+  GifOutput& output;                       // destination of the sub-blocks
+  uint32_t bit_buffer;                     // bits not yet written
+  int bit_count;                           // number of bits in bit_buffer
+  unsigned char block[GIF_SUB_BLOCK_BYTES]; // current sub-block
+  int block_used;                          // number of bytes in block
+};
+
+/**
+ * @brief LZW compresses 8 bit palette indices into GIF image data
+ *
+ * @details GIF_COMPRESS_BEST looks up (prefix, index) pairs in an open
+ *            addressing hash table and emits a clear code when the
+ *            dictionary is full. Slots are tagged with a
+ *            generation number, so starting a new dictionary only bumps the
+ *            generation instead of clearing the table. GIF_COMPRESS_NONE emits
+ *            every index as its own code and a clear code every 254 codes,
+ *            so readers never grow past 9 bit codes.
+ *
+ * @pre indices is not empty
+ * @post the minimum code size, data sub-blocks and terminator are written
+ *
+ * @param indices palette index of every pixel in row major order
+ * @param compression trade between output size and speed
+ * @param output destination file
+ */
+static void writeLzwData(const vector<unsigned char>& indices,
+                         GifCompression compression, GifOutput& output) {
+
+  const int min_code_size = 8;
+  const int clear_code = 1 << min_code_size;
+  const int end_code = clear_code + 1;
+
+  output.put((unsigned char)min_code_size);
+  LzwCodeWriter writer(output);
+  int width = min_code_size + 1;
+  writer.write(clear_code, width);
+
+  // Literal codes only, clear before readers would widen the codes
+  if (compression == GIF_COMPRESS_NONE) {
+    int since_clear = 0;
+    for (size_t i = 0; i < indices.size(); ++i) {
+      if (since_clear == (1 << width) - clear_code - 2) {
+        writer.write(clear_code, width);
+        since_clear = 0;
+      }
+      writer.write(indices[i], width);
+      ++since_clear;
+    }
+    writer.write(end_code, width);
+    writer.finish();
+    return;
+  }
+
+  // Hash table with at most half its slots in use. A slot holds its 20 bit
+  // (prefix, index) key and the 12 bit generation that wrote it; slots of
+  // older generations count as free.
+  const int table_bits = 13;
+  size_t table_mask = ((size_t)1 << table_bits) - 1;
+  vector<uint32_t> keys(table_mask + 1, 0);
+  vector<uint16_t> codes(table_mask + 1);
+  uint32_t generation = 1;
+
+  int next_code = clear_code + 2;
+  int prefix = indices[0];
+
+  for (size_t i = 1; i < indices.size(); ++i) {
+    uint32_t key = ((uint32_t)prefix << 8) | indices[i];
+    uint32_t tagged_key = key | (generation << 20);
+    size_t slot = (key * 2654435761u) >> (32 - table_bits);
+
+    // Linear probe until the key or a free slot is found
+    while ((keys[slot] >> 20) == generation && keys[slot] != tagged_key) {
+      slot = (slot + 1) & table_mask;
+    }
+    if (keys[slot] == tagged_key) {
+      prefix = codes[slot];
+      continue;
+    }
+
+    writer.write(prefix, width);
+
+    if (next_code < GIF_MAX_CODES) {
+
+      // Add prefix + index, widen once the new code no longer fits
+      keys[slot] = tagged_key;
+      codes[slot] = (uint16_t)next_code++;
+      if (next_code > (1 << width)) {
+        ++width;
+      }
+    } else {
+
+      // Dictionary is full, start a new one
+      writer.write(clear_code, width);
+      if (++generation == 1u << 12) {
+        keys.assign(keys.size(), 0);
+        generation = 1;
+      }
+      next_code = clear_code + 2;
+      width = min_code_size + 1;
+    }
+    prefix = indices[i];
+  }
+
+  writer.write(prefix, width);
+  writer.write(end_code, width);
+  writer.finish();
+}
+
+/**
+ * @brief Writes a single frame GIF with a 256 entry palette
+ *
+ * @pre rows and cols are between 1 and 65535, palette has 768 entries,
+ *        indices has rows * cols entries
+ * @post the GIF file is written
+ *
+ * @param filename name of the file to write
+ * @param rows number of rows of the image
+ * @param cols number of columns of the image
+ * @param palette red, green, blue of each of the 256 palette entries
+ * @param indices palette index of every pixel in row major order
+ * @param compression trade between output size and speed
+ * @return true if the file was written
+ */
+static bool writeGif(const string& filename, int rows, int cols,
+                     const unsigned char* palette,
+                     const vector<unsigned char>& indices,
+                     GifCompression compression) {
+
+  GifOutput output(filename);
+  if (!output.good()) {
+    return false;
+  }
+
+  // Header and logical screen with a 256 entry, 8 bit global palette
+  output.write(reinterpret_cast<const unsigned char*>("GIF87a"), 6);
+  output.putShort(cols);
+  output.putShort(rows);
+  output.put(0xF7);
+  output.put(0);
+  output.put(0);
+  output.write(palette, 256 * 3);
+
+  // Image descriptor covering the whole screen, not interlaced
+  output.put(0x2C);
+  output.putShort(0);
+  output.putShort(0);
+  output.putShort(cols);
+  output.putShort(rows);
+  output.put(0);
+
+  writeLzwData(indices, compression, output);
+
+  // Trailer
+  output.put(0x3B);
+  output.flush();
+  return output.good();
+}
+
+/**
+ * @brief Returns true if img can be stored in a GIF
+ *
+ * @param img image to check
+ * @return true if img has between 1 and 65535 rows and columns
+ */
+static bool fitsInGif(const Image& img) {
+  return img.getRows() > 0 && img.getCols() > 0 &&
+         img.getRows() <= 0xFFFF && img.getCols() <= 0xFFFF;
+}
+
+bool writeGreyGifImage(const Image& img, const string& filename,
+                       GifCompression compression) {
+
+  if (!fitsInGif(img)) {
+    return false;
+  }
+
+  // Palette entry i is grey level i, so indices are the grey values
+  unsigned char palette[256 * 3];
+  for (int i = 0; i < 256; ++i) {
+    palette[3 * i] = palette[3 * i + 1] = palette[3 * i + 2] =
+      (unsigned char)i;
+  }
+
+  vector<unsigned char> indices((size_t)img.getRows() * img.getCols());
+  size_t index = 0;
+  for (int row = 0; row < img.getRows(); ++row) {
+    for (int col = 0; col < img.getCols(); ++col) {
+      indices[index++] = img.getPixel(row, col).grey;
+    }
+  }
+
+  return writeGif(filename, img.getRows(), img.getCols(), palette, indices,
+                  compression);
+}
+
+bool writeColorGifImage(const Image& img, const string& filename,
+                        GifCompression compression) {
+
+  if (!fitsInGif(img)) {
+    return false;
+  }
+
+  // 3 bits of red, 3 bits of green and 2 bits of blue per palette entry
+  unsigned char palette[256 * 3];
+  for (int i = 0; i < 256; ++i) {
+    palette[3 * i] = (unsigned char)((i >> 5) * 255 / 7);
+    palette[3 * i + 1] = (unsigned char)(((i >> 2) & 7) * 255 / 7);
+    palette[3 * i + 2] = (unsigned char)((i & 3) * 255 / 3);
+  }
+
+  vector<unsigned char> indices((size_t)img.getRows() * img.getCols());
+  size_t index = 0;
+  for (int row = 0; row < img.getRows(); ++row) {
+    for (int col = 0; col < img.getCols(); ++col) {
+      pixel p = img.getPixel(row, col);
+      indices[index++] =
+        (unsigned char)((p.red & 0xE0) | ((p.green >> 3) & 0x1C) |
+                        (p.blue >> 6));
+    }
+  }
+
+  return writeGif(filename, img.getRows(), img.getCols(), palette, indices,
+                  compression);
+}
+
+/**
+ * @brief Expands LZW image data into palette indices
+ *
+ * @details Each dictionary entry stores its prefix code, last index, first
+ *            index and length, so a code is expanded by walking its prefixes
+ *            and writing the string back to front straight into indices.
+ *          Decoding stops once indices is full, or earlier at the end code,
+ *            at the end of the data or at an invalid code.
+ *
+ * @pre 2 <= min_code_size <= 8
+ * @post indices holds the decoded palette indices, entries past the returned
+ *         count are unchanged
+ *
+ * @param data LZW data with the sub-block length bytes removed
+ * @param min_code_size LZW minimum code size of the image
+ * @param indices receives the palette index of every pixel
+ * @return number of indices decoded, less than indices.size() when the data
+ *           is truncated or corrupt
+ */
+static size_t readLzwData(const vector<unsigned char>& data, int min_code_size,
+                        vector<unsigned char>& indices) {
+
+  const int clear_code = 1 << min_code_size;
+  const int end_code = clear_code + 1;
+
+  uint16_t prefix[GIF_MAX_CODES];
+  unsigned char suffix[GIF_MAX_CODES];
+  unsigned char first[GIF_MAX_CODES];
+  uint16_t length[GIF_MAX_CODES];
+  for (int code = 0; code < clear_code; ++code) {
+    prefix[code] = 0;
+    suffix[code] = first[code] = (unsigned char)code;
+    length[code] = 1;
+  }
+
+  size_t total = indices.size();
+  size_t pos = 0;
+  size_t in = 0;
+  uint32_t bit_buffer = 0;
+  int bit_count = 0;
+  int width = min_code_size + 1;
+  int next_code = clear_code + 2;
+  int previous = -1;
+
+  while (pos < total) {
+
+    // Refill, codes are read LSB first
+    while (bit_count < width && in < data.size()) {
+      bit_buffer |= (uint32_t)data[in++] << bit_count;
+      bit_count += 8;
+    }
+    if (bit_count < width) {
+      break;
+    }
+    int code = (int)(bit_buffer & ((1u << width) - 1));
+    bit_buffer >>= width;
+    bit_count -= width;
+
+    if (code == clear_code) {
+      width = min_code_size + 1;
+      next_code = clear_code + 2;
+      previous = -1;
+      continue;
+    }
+    if (code == end_code) {
+      break;
+    }
+
+    // First code after a clear must be a single index
+    if (previous == -1) {
+      if (code >= clear_code) {
+        break;
+      }
+      indices[pos++] = (unsigned char)code;
+      previous = code;
+      continue;
+    }
+    if (code > next_code) {
+      break;
+    }
+
+    // Add previous + first index of code; when code is the entry being
+    // defined, its first index is the first index of previous
+    if (next_code < GIF_MAX_CODES) {
+      prefix[next_code] = (uint16_t)previous;
+      suffix[next_code] = code < next_code ? first[code] : first[previous];
+      first[next_code] = first[previous];
+      length[next_code] = (uint16_t)(length[previous] + 1);
+      ++next_code;
+    }
+
+    // Write the string of code back to front, dropping what does not fit
+    size_t len = length[code];
+    int walk = code;
+    for (size_t i = len; i > 0; --i) {
+      if (pos + i - 1 < total) {
+        indices[pos + i - 1] = suffix[walk];
+      }
+      walk = prefix[walk];
+    }
+    pos += len;
+
+    if (next_code == (1 << width) && width < 12) {
+      ++width;
+    }
+    previous = code;
+  }
+
+  return pos < total ? pos : total;
+}
+
+bool readGifImage(const string& filename, Image& img) {
+
+  // Read the whole file with a single read
+  ifstream in(filename.c_str(), ios::binary | ios::ate);
+  if (!in) {
+    return false;
+  }
+  streamoff file_size = in.tellg();
+  vector<unsigned char> file(file_size > 0 ? (size_t)file_size : 0);
+  in.seekg(0);
+  in.read(reinterpret_cast<char*>(file.data()), file.size());
+  if (!in || file.size() < 13 ||
+      (string(file.begin(), file.begin() + 6) != "GIF87a" &&
+       string(file.begin(), file.begin() + 6) != "GIF89a")) {
+    return false;
+  }
+
+  // Global palette
+  size_t pos = 10;
+  unsigned char screen_flags = file[pos];
+  pos = 13;
+  const unsigned char* palette = nullptr;
+  int palette_size = 0;
+  if (screen_flags & 0x80) {
+    palette_size = 2 << (screen_flags & 7);
+    if (pos + 3 * palette_size > file.size()) {
+      return false;
+    }
+    palette = &file[pos];
+    pos += 3 * palette_size;
+  }
+
+  // Skip extensions up to the first image descriptor
+  while (pos < file.size() && file[pos] != 0x2C) {
+    if (file[pos] != 0x21 || pos + 2 > file.size()) {
+      return false;
+    }
+    pos += 2;
+    while (pos < file.size() && file[pos] != 0) {
+      pos += file[pos] + 1;
+    }
+    ++pos;
+  }
+  if (pos + 10 > file.size()) {
+    return false;
+  }
+
+  int cols = file[pos + 5] | (file[pos + 6] << 8);
+  int rows = file[pos + 7] | (file[pos + 8] << 8);
+  unsigned char image_flags = file[pos + 9];
+  pos += 10;
+
+  // Local palette replaces the global one
+  if (image_flags & 0x80) {
+    palette_size = 2 << (image_flags & 7);
+    if (pos + 3 * palette_size > file.size()) {
+      return false;
+    }
+    palette = &file[pos];
+    pos += 3 * palette_size;
+  }
+
+  if (rows == 0 || cols == 0 || pos >= file.size()) {
+    return false;
+  }
+  int min_code_size = file[pos++];
+  if (min_code_size < 2 || min_code_size > 8) {
+    return false;
+  }
+
+  // Join the data sub-blocks
+  vector<unsigned char> data;
+  while (pos < file.size() && file[pos] != 0) {
+    size_t block_size = file[pos++];
+    if (pos + block_size > file.size()) {
+      block_size = file.size() - pos;
+    }
+    data.insert(data.end(), file.begin() + pos, file.begin() + pos + block_size);
+    pos += block_size;
+  }
+
+  // Truncated or corrupt data leaves pixels undecoded
+  vector<unsigned char> indices((size_t)rows * cols);
+  if (readLzwData(data, min_code_size, indices) < indices.size()) {
+    return false;
+  }
+
+  // Interlaced images store rows 0, 8, ..., then 4, 12, ..., 2, 6, ..., 1, 3,
+  vector<int> row_order(rows);
+  if (image_flags & 0x40) {
+    const int starts[4] = { 0, 4, 2, 1 };
+    const int steps[4] = { 8, 8, 4, 2 };
+    int stored = 0;
+    for (int pass = 0; pass < 4; ++pass) {
+      for (int row = starts[pass]; row < rows; row += steps[pass]) {
+        row_order[stored++] = row;
+      }
+    }
+  } else {
+    for (int row = 0; row < rows; ++row) {
+      row_order[row] = row;
+    }
+  }
+
+  Image result(rows, cols);
+  if (result.getRows() != rows) {
+    return false;
+  }
+
+  // Without a palette, treat indices as grey levels
+  size_t index = 0;
+  for (int stored = 0; stored < rows; ++stored) {
+    int row = row_order[stored];
+    for (int col = 0; col < cols; ++col) {
+      int entry = indices[index++];
+      byte red = (byte)entry;
+      byte green = (byte)entry;
+      byte blue = (byte)entry;
+      if (entry < palette_size) {
+        red = palette[3 * entry];
+        green = palette[3 * entry + 1];
+        blue = palette[3 * entry + 2];
+      }
+      result.setPixel(row, col, red, green, blue);
+      result.setGrey(row, col, (byte)((red + 2 * green + blue) / 4));
+    }
+  }
+
+  img = result;
+  return true;
+}
@@ -0,0 +1,83 @@
+/*********************************************************************
+ * @file      GifCodec.h
+ * @brief     GIF reader and writer for Image objects, used for every GIF
+ *              the program reads or writes.
+ *
+ * @details   Decoding reads the whole file with one read and expands LZW
+ *              codes through flat prefix / suffix / length tables, writing
+ *              each code's string directly into the index buffer.
+ *            Encoding looks up (prefix, byte) pairs in an open addressing
+ *              hash table and writes through a large output buffer.
+ *            Greylevel images are written with a 256 entry grey palette, so
+ *              reading them back gives exactly the grey values written.
+ *            The functions keep no shared state and may be called from
+ *              several threads at once.
+ *********************************************************************/
+
+#pragma once
+
+#include <string>
+
+#include "Image.h"
+
+/**
+ * @brief Trade between output size and encoding speed
+ *
+ * @details GIF_COMPRESS_NONE skips every dictionary lookup and always writes
+ *            about 9 bits per pixel, whatever the image holds.
+ *            GIF_COMPRESS_BEST does one hash lookup per pixel and writes
+ *            fewer bits the more the image repeats itself, so smooth images
+ *            gain the most from it.
+ */
+enum GifCompression {
+  GIF_COMPRESS_BEST, // full 4096 entry LZW dictionary
+  GIF_COMPRESS_NONE  // literal codes only, no dictionary lookups
+};
+
+/**
+ * @brief Reads the first image of a GIF file
+ *
+ * @pre filename refers to a file that stores a GIF image
+ * @post on success img holds the image, with red, green and blue from the
+ *         palette and grey (red + 2 * green + blue) / 4 as Image.lib computes
+ *         it; on failure img is unchanged
+ *
+ * @param filename name of the GIF file to read
+ * @param img receives the decoded image
+ * @return true if the file was decoded, false if it is not a GIF or its
+ *           image data ends before every pixel is decoded
+ */
+bool readGifImage(const string& filename, Image& img);
+
+/**
+ * @brief Writes the grey values of img as a GIF with a 256 level grey palette.
+ *          The image read back is exactly the grey values written.
+ *
+ * @pre filename refers to a valid location to store an image, img has at most
+ *        65535 rows and columns
+ * @post the GIF file is written
+ *
+ * @param img image whose grey values are written
+ * @param filename name of the GIF file to write
+ * @param compression trade between file size and encoding speed
+ * @return true if the file was written
+ */
+bool writeGreyGifImage(const Image& img, const string& filename,
+                       GifCompression compression = GIF_COMPRESS_BEST);
+
+/**
+ * @brief Writes the red, green and blue values of img as a GIF. Colors are
+ *          reduced to a fixed 3-3-2 bit palette, so the stored image is an
+ *          approximation of the pixel values.
+ *
+ * @pre filename refers to a valid location to store an image, img has at most
+ *        65535 rows and columns
+ * @post the GIF file is written
+ *
+ * @param img image whose colors are written
+ * @param filename name of the GIF file to write
+ * @param compression trade between file size and encoding speed
+ * @return true if the file was written
+ */
+bool writeColorGifImage(const Image& img, const string& filename,
+                        GifCompression compression = GIF_COMPRESS_BEST);
@@ -3,8 +3,10 @@
  * @brief     Program takes an input image named "test2.gif" and outputs
  *              two images called "smooth.gif" and "edges.gif" which show the
  *              greyscale image smoothed using simple 1/4, 1/2, 1/4 gaussian
- *              linear filtering and edging using a threshhold of 10 and non
- *              maximum suppression for edges.
+ *              linear filtering and edging using a threshhold and non
+ *              maximum suppression for edges. The threshhold is 10 unless
+ *              --threshold sets it or --percentile / --otsu choose it from
+ *              the gradient magnitudes.
  * 
  * @details   main method drives program through 9 nine steps which take input
  *              image, smoothes the image, prints out the smoothed image,
@@ -20,9 +22,20 @@
  * Prof. Clark Olson
  *********************************************************************/
 
-#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
 
+#include "BoundedQueue.h"
+#include "GifCodec.h"
 #include "Image.h"
 
 /**
@@ -41,6 +54,55 @@ struct center {
   int col; // col of center pix
 };
 
+/**
+ * @brief struct EdgePoint holds one edge pixel found by non maximum suppression
+ */
+struct EdgePoint {
+  int row;           // row of edge pix
+  int col;           // col of edge pix
+  float magnitude;   // gradient magnitude at the edge pix
+  float orientation; // direction toward brighter pixels, see writeEdgeList
+  float offset;      // subpixel peak position along orientation, (-0.5, 0.5)
+};
+
+/**
+ * @brief struct EdgeOptions holds the settings of one edge detection run
+ */
+struct EdgeOptions {
+  int iterations = 0;     // number of smoothing iterations in X and in Y
+  float threshold = 10;   // fixed edge threshold
+  float percentile = -1;  // if >= 0, threshold is this gmag percentile
+  bool otsu = false;      // if true, threshold is chosen by Otsu's method
+  bool edge_list = false; // write edges as an edge list instead of a GIF
+  bool subpixel = false;  // include subpixel offsets in the edge list
+  int magnitude_threads = 0; // threads for STEP 7, 0 for one per core
+  GifCompression gif_compression = GIF_COMPRESS_BEST; // GIF size vs speed
+};
+
+/**
+ * @brief struct EdgeResult holds the outputs of one edge detection run
+ */
+struct EdgeResult {
+  Image smooth;                  // byte image after smoothing
+  Image edges;                   // byte edge image, empty with edge_list
+  vector<EdgePoint> edge_points; // edge pixels, filled with edge_list
+  float threshold = 0;           // threshold that was applied
+  int edge_count = 0;            // number of edge pixels
+};
+
+/**
+ * @brief Size of the buffer used to stream edge lists to disk
+ */
+const size_t EDGE_LIST_BUFFER_BYTES = 64 * 1024;
+
+/**
+ * @brief Number of bins and upper bound of the gradient magnitude histogram.
+ *          Gradients of a byte image are at most 255 in x and y, so
+ *          magnitudes stay below 255 * sqrt(2) ~= 360.6.
+ */
+const int GMAG_HISTOGRAM_BINS = 1024;
+const float GMAG_HISTOGRAM_MAX = 361.0f;
+
 /**
  * @brief checks if a file is in the directory or not
  *
@@ -73,6 +135,149 @@ bool pixelInImage(const Image& img, int row, int col) {
            col > img.getCols() - 1);
 }
 
+/**
+ * @brief Size in bytes of the working set a vertical strip may occupy, chosen
+ *          to stay resident in a typical per-core L2 cache.
+ */
+const int VERTICAL_STRIP_BYTES = 256 * 1024;
+
+/**
+ * @brief Convolves img with a 3 x 1 vertical kernel iterations times in a row,
+ *          producing the same values as calling convolveImage iterations
+ *          times.
+ *
+ * @details The image is processed in column strips sized so that two strip
+ *            buffers fit in VERTICAL_STRIP_BYTES. Strips are never narrower
+ *            than 16 columns (one cache line), so images taller than
+ *            VERTICAL_STRIP_BYTES / 128 = 2048 rows exceed that budget: the
+ *            working set is then 128 * rows bytes, e.g. 1 MB at 8192 rows,
+ *            and only the last level cache holds it.
+ *          Each strip is copied out of img once, all iterations are applied
+ *            while it stays in cache (temporal blocking), and it is copied
+ *            into the result once.
+ *          Inside a strip four output rows are produced per step so the six
+ *            input rows they share are loaded once (register blocking) and the
+ *            column loop runs over contiguous memory.
+ *          Out of image taps follow convolveImage: a tap one row above the
+ *            first row reads row 2, a tap one row below the last row reads
+ *            row rows - 3.
+ *
+ * @pre knl is 3 x 1, img has at least 3 rows and holds float values
+ * @post no change to objects
+ *
+ * @param img input image to get original values from
+ * @param knl 3 x 1 kernel to obtain weighted values
+ * @param iterations number of times the kernel is applied
+ * @return new image which is the result of convolving img with knl
+ *          iterations times
+ */
+Image convolveVertical(const Image& img, const Image& knl, int iterations) {
+
+  int rows = img.getRows();
+  int cols = img.getCols();
+  Image result(rows, cols);
+
+  // Kernel weights in the order convolveImage accumulates them: the row below
+  // the output pixel, the output row, and the row above it
+  float w_below = knl.getFloat(0, 0);
+  float w_center = knl.getFloat(1, 0);
+  float w_above = knl.getFloat(2, 0);
+
+  // Strip width in columns, a multiple of 16 floats (one cache line), at
+  // least one cache line wide even when that overruns VERTICAL_STRIP_BYTES
+  int strip_cols = VERTICAL_STRIP_BYTES / (2 * (int)sizeof(float) * rows);
+  strip_cols = strip_cols / 16 * 16;
+  if (strip_cols < 16) {
+    strip_cols = 16;
+  }
+  if (strip_cols > cols) {
+    strip_cols = cols;
+  }
+
+  vector<float> strip_in((size_t)rows * strip_cols);
+  vector<float> strip_out((size_t)rows * strip_cols);
+
+  for (int first_col = 0; first_col < cols; first_col += strip_cols) {
+
+    int width = cols - first_col < strip_cols ? cols - first_col : strip_cols;
+
+    // Copy the strip out of the image, rows are width floats apart
+    for (int row = 0; row < rows; ++row) {
+      float* dst = &strip_in[(size_t)row * width];
+      for (int col = 0; col < width; ++col) {
+        dst[col] = img.getFloat(row, first_col + col);
+      }
+    }
+
+    // Apply every iteration while the strip is in cache
+    for (int i = 0; i < iterations; ++i) {
+      const float* in = strip_in.data();
+      float* out = strip_out.data();
+
+      // First row, the tap above it reads row 2
+      for (int col = 0; col < width; ++col) {
+        out[col] = in[width + col] * w_below + in[col] * w_center +
+                   in[2 * width + col] * w_above;
+      }
+
+      // Interior rows four at a time, sharing the six input rows they read
+      int row = 1;
+      for (; row + 4 <= rows - 1; row += 4) {
+        const float* r0 = in + (size_t)(row - 1) * width;
+        const float* r1 = r0 + width;
+        const float* r2 = r1 + width;
+        const float* r3 = r2 + width;
+        const float* r4 = r3 + width;
+        const float* r5 = r4 + width;
+        float* o = out + (size_t)row * width;
+        for (int col = 0; col < width; ++col) {
+          float a = r0[col];
+          float b = r1[col];
+          float c = r2[col];
+          float d = r3[col];
+          float e = r4[col];
+          float f = r5[col];
+          o[col] = c * w_below + b * w_center + a * w_above;
+          o[width + col] = d * w_below + c * w_center + b * w_above;
+          o[2 * width + col] = e * w_below + d * w_center + c * w_above;
+          o[3 * width + col] = f * w_below + e * w_center + d * w_above;
+        }
+      }
+
+      // Remaining interior rows
+      for (; row < rows - 1; ++row) {
+        const float* center_row = in + (size_t)row * width;
+        float* o = out + (size_t)row * width;
+        for (int col = 0; col < width; ++col) {
+          o[col] = center_row[width + col] * w_below +
+                   center_row[col] * w_center +
+                   center_row[col - width] * w_above;
+        }
+      }
+
+      // Last row, the tap below it reads row rows - 3
+      const float* last = in + (size_t)(rows - 1) * width;
+      float* o = out + (size_t)(rows - 1) * width;
+      for (int col = 0; col < width; ++col) {
+        o[col] = last[col - 2 * width] * w_below + last[col] * w_center +
+                 last[col - width] * w_above;
+      }
+
+      strip_in.swap(strip_out);
+    }
+
+    // Copy the finished strip into the result
+    for (int row = 0; row < rows; ++row) {
+      const float* src = &strip_in[(size_t)row * width];
+      for (int col = 0; col < width; ++col) {
+        result.setFloat(row, first_col + col, src[col]);
+      }
+    }
+  }
+
+  return result;
+}
+
 /**
  * @brief Convolves image img with img knl with opposite pixel position pull for
  *          assoc/commut interactions.
@@ -90,6 +295,11 @@ bool pixelInImage(const Image& img, int row, int col) {
  */
 Image convolveImage(const Image& img, const Image& knl, center knl_cnt) {
 
+  // Vertical 3 tap kernels (Sy, gradient y) take the cache blocked path
+  if (knl.getRows() == 3 && knl.getCols() == 1 && img.getRows() >= 3) {
+    return convolveVertical(img, knl, 1);
+  }
+
   // Result image to return
   Image result(img.getRows(), img.getCols());
 
@@ -364,88 +574,57 @@ pixel interpolate(const Image& img, float d_col, float d_row) {
 
 
 /**
- * @brief main method drives program through 9 nine steps which take an input
- *          image, smoothes the image, prints out the smoothed image, creates
- *          edge detection gradient images in x and y direction, combine the
- *          gradient images, and creates an edge image based on the created
- *          magnitude given threshold and maximus suppression.
- * 
- * @detail 
- *    STEP 1: INPUT IN
- *    STEP 2: Initialize test2.gif
- *    STEP 3: Create floating point image
- *    STEP 4: Smooth image argv[1] times
- *    STEP 5: Intermediary printing of smooth.gif
- *    STEP 6: Create gx and gy gradient images
- *    STEP 7: Combine gx and gy gradient images into gmag image
- *    STEP 8: Edge gmag image based on interpolated threshold
- *    STEP 9: Output image
- * 
- * @pre Program must run with input argv[1] which gives n number of smoothing
- *        "test2.gif" must be present in the directory
- * @post Prints out 2 images, smooth.gif and edges.gif
- * 
- * @param argc input counter
- * @param argv input array, [1] containing program name [2] containing n number
- *          of desired smoothing iterations
- * @return 0 if normal exit
+ * @brief Smooths img with the Sx kernel iterations times and then with the Sy
+ *          kernel iterations times (STEP 4).
+ *
+ * @pre img holds float values
+ * @post no change to img
+ *
+ * @param img input float image to smooth
+ * @param iterations number of smoothing passes in each direction
+ * @return new float image holding the smoothed result
  */
-int main(int argc, char* argv[]) {
-
-  // STEP 1 INPUT IN------------------------------------------------------------
-  // Ends program is test1.gif is not found in the directory
-  if (!fileIsInDirectory("test2.gif")) {
-    std::cout << "File test2.gif was not found" << endl;
-    return -1;
-  }
-
-  // If not enough argument provided
-  if (argc < 2) {
-    std::cout << "Did not provide number of iterations as an argument." << endl;
-    return -1;
-  }
-
-  // STEP 2 test2.gif-----------------------------------------------------------
-  // Initialize input image in local directory within program
-  Image img("test2.gif");
-
-  // STEP 3 FLOATING POINT IMG--------------------------------------------------
-  // Convert image pixel RGB to float
-  convertImageToFloat(img);
-
-  // STARTING IMAGE AS FLOAT
-  // Test image for after image converted to float
-  //img.writeFloatImage("before_smooth.gif");
+Image smoothImage(const Image& img, int iterations) {
 
-  // STEP 4A CREATE HARD CODED GAUUSSIAN FOR SMOOTHING
   // Create hardcoded kernels for Gaussian representative smoothing
   // Uses 1/4, 1/2, 1/4 for values, respectively.
   Image Sx_kernel = createSxKernel();
   Image Sy_kernel = createSyKernel();
 
-  // STEP 4B CREATE CENTER HOLDERS FOR KERNELS
   // Create struct variables holding center of the kernels
-  // This is applicable for both x knls and both y knls (smooth & grad)
   center x_knl_cnt(Sx_kernel);
   center y_knl_cnt(Sy_kernel);
 
-  // STEP 4C SMOOTH i times in X and Y directions
-  // Smooth for iteration_num number of iterations to the output image
-  int iteration_num = stoi(argv[1]);
-  for (int i = 0; i < iteration_num; ++i) {
-    img = convolveImage(img, Sx_kernel, x_knl_cnt);
+  Image result(img);
+
+  // Smooth for iterations number of iterations in X, then in Y
+  for (int i = 0; i < iterations; ++i) {
+    result = convolveImage(result, Sx_kernel, x_knl_cnt);
   }
+  if (iterations > 0 && result.getRows() >= 3) {
 
-  // STEP 4C Continued
-  for (int i = 0; i < iteration_num; ++i) {
-    img = convolveImage(img, Sy_kernel, y_knl_cnt);
+    // All Y iterations are fused into one cache blocked sweep
+    result = convolveVertical(result, Sy_kernel, iterations);
+  } else {
+    for (int i = 0; i < iterations; ++i) {
+      result = convolveImage(result, Sy_kernel, y_knl_cnt);
+    }
   }
 
-  // STEP 5 Intermediary print, Convert to bytes and print smooth.gif-----------
-  Image after_smoothing = createByteImage(img);
-  after_smoothing.writeGreyImage("smooth.gif");
+  return result;
+}
 
-  // STEP 6 Calculate gradient in X and gradient in Y---------------------------
+/**
+ * @brief Creates the gx and gy gradient images of img (STEP 6)
+ *
+ * @pre img holds float values
+ * @post gx and gy are replaced by the x and y gradient images of img
+ *
+ * @param img input float image to take the gradients of
+ * @param gx output image for the gradient in the x direction
+ * @param gy output image for the gradient in the y direction
+ */
+void computeGradients(const Image& img, Image& gx, Image& gy) {
 
   // Create gradient_x and gradient_y kernels
   Image gradient_x = createXGradientKernel();
@@ -456,29 +635,31 @@ int main(int argc, char* argv[]) {
   center gy_knl_cnt(gradient_y);
 
   // Convolve images to create gx and gy with gradient x and gradient y
-  Image gx = convolveImage(img, gradient_x, gx_knl_cnt);
-  Image gy = convolveImage(img, gradient_y, gy_knl_cnt);
-
-  // GX and GY float images for testing
-  //gx.writeFloatImage("gx.gif");
-  //gy.writeFloatImage("gy.gif");
-
-  // Print after_gx image and after_gy image for testing
-  //Image after_gx = createByteImage(gx);
-  //Image after_gy = createByteImage(gy);
-  //after_gx.writeGreyImage("after_gx.gif");
-  //after_gy.writeGreyImage("after_gy.gif");
-
-  // STEP 7 Gradient Magnitude--------------------------------------------------
-
-  // Image gmag combines information from gx and gy with threshold 10
-  Image gmag(img.getRows(), img.getCols());
+  gx = convolveImage(img, gradient_x, gx_knl_cnt);
+  gy = convolveImage(img, gradient_y, gy_knl_cnt);
+}
 
-  // Set gmag to the calculation of gx and gy
-  // sqrt( (gx)^2 + (gy)^2 )
+/**
+ * @brief Combines rows [first_row, last_row) of gx and gy into gmag and counts
+ *          the non zero magnitudes into histogram.
+ *
+ * @pre gx, gy and gmag have the same dimensions, histogram is nullptr or has
+ *        GMAG_HISTOGRAM_BINS zeroed bins
+ * @post gmag rows are set, histogram counts the non zero magnitudes of the rows
+ *
+ * @param gx gradient image in the x direction
+ * @param gy gradient image in the y direction
+ * @param gmag output gradient magnitude image
+ * @param first_row first row to compute
+ * @param last_row one past the last row to compute
+ * @param histogram optional histogram of the non zero magnitudes
+ */
+void computeGradientMagnitudeRows(const Image& gx, const Image& gy,
+                                  Image& gmag, int first_row, int last_row,
+                                  vector<int>* histogram) {
 
-  // for every row of gmag
-  for (int row = 0; row < gmag.getRows(); ++row) {
+  // for every row of the band
+  for (int row = first_row; row < last_row; ++row) {
 
     // for every column of gmag
     for (int col = 0; col < gmag.getCols(); ++col) {
@@ -492,101 +673,962 @@ int main(int argc, char* argv[]) {
 
       // Set pixel
       gmag.setFloat(row, col, sqrt_gx_gy);
+
+      // Count non zero magnitudes, anything past the range goes in the top bin
+      if (histogram != nullptr && sqrt_gx_gy > 0) {
+        int bin = (int)(sqrt_gx_gy * (GMAG_HISTOGRAM_BINS / GMAG_HISTOGRAM_MAX));
+        if (bin >= GMAG_HISTOGRAM_BINS) {
+          bin = GMAG_HISTOGRAM_BINS - 1;
+        }
+        ++(*histogram)[bin];
+      }
     }
   }
+}
 
-  // Print after_gmag image for testing
-  //gmag.writeFloatImage("gmag.gif");
+/**
+ * @brief Combines gx and gy into the gradient magnitude image (STEP 7)
+ *
+ * @details Rows are split into one band per thread. When a histogram
+ *            is requested every thread counts into its own private copy while
+ *            it computes its band, and the copies are summed afterwards, so
+ *            the histogram costs no extra pass over gmag.
+ *
+ * @pre gx and gy are float images of the same dimensions
+ * @post if histogram is not nullptr it holds GMAG_HISTOGRAM_BINS bins counting
+ *         the non zero magnitudes of gmag
+ *
+ * @param gx gradient image in the x direction
+ * @param gy gradient image in the y direction
+ * @param histogram optional output histogram of the non zero magnitudes
+ * @param thread_count number of threads to use, 0 for one per core
+ * @return new float image holding sqrt( (gx)^2 + (gy)^2 ) at every pixel
+ */
+Image computeGradientMagnitude(const Image& gx, const Image& gy,
+                               vector<int>* histogram = nullptr,
+                               int thread_count = 0) {
 
-  // Step 8 Edge Image----------------------------------------------------------
+  Image gmag(gx.getRows(), gx.getCols());
+
+  if (thread_count <= 0) {
+    thread_count = (int)thread::hardware_concurrency();
+  }
+  if (thread_count > gmag.getRows()) {
+    thread_count = gmag.getRows();
+  }
+  if (thread_count < 1) {
+    thread_count = 1;
+  }
+
+  vector<vector<int>> thread_histograms(
+    histogram != nullptr ? thread_count : 0,
+    vector<int>(GMAG_HISTOGRAM_BINS, 0));
+
+  // Each thread computes one band of rows, the calling thread takes the last
+  vector<thread> threads;
+  for (int t = 0; t < thread_count; ++t) {
+    int first_row = (int)((long long)gmag.getRows() * t / thread_count);
+    int last_row = (int)((long long)gmag.getRows() * (t + 1) / thread_count);
+    vector<int>* band_histogram =
+      histogram != nullptr ? &thread_histograms[t] : nullptr;
+
+    if (t == thread_count - 1) {
+      computeGradientMagnitudeRows(gx, gy, gmag, first_row, last_row,
+                                   band_histogram);
+    } else {
+      threads.push_back(thread(computeGradientMagnitudeRows, cref(gx),
+                               cref(gy), ref(gmag), first_row, last_row,
+                               band_histogram));
+    }
+  }
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+
+  // Merge the private histograms
+  if (histogram != nullptr) {
+    histogram->assign(GMAG_HISTOGRAM_BINS, 0);
+    for (size_t t = 0; t < thread_histograms.size(); ++t) {
+      for (int bin = 0; bin < GMAG_HISTOGRAM_BINS; ++bin) {
+        (*histogram)[bin] += thread_histograms[t][bin];
+      }
+    }
+  }
+
+  return gmag;
+}
+
+/**
+ * @brief Returns the gradient magnitude below which percentile percent of the
+ *          non zero magnitudes lie.
+ *
+ * @pre histogram has GMAG_HISTOGRAM_BINS bins, 0 <= percentile <= 100
+ * @post no change to objects
+ *
+ * @param histogram histogram of the non zero magnitudes
+ * @param percentile percentage of magnitudes to fall below the threshold
+ * @return upper edge of the bin where the cumulative count reaches percentile
+ */
+float percentileThreshold(const vector<int>& histogram, float percentile) {
+
+  long long total = 0;
+  for (int bin = 0; bin < GMAG_HISTOGRAM_BINS; ++bin) {
+    total += histogram[bin];
+  }
+
+  double target = total * (percentile / 100.0);
+  long long cumulative = 0;
+  int bin = 0;
+  for (; bin < GMAG_HISTOGRAM_BINS - 1; ++bin) {
+    cumulative += histogram[bin];
+    if (cumulative >= target) {
+      break;
+    }
+  }
+
+  return (bin + 1) * (GMAG_HISTOGRAM_MAX / GMAG_HISTOGRAM_BINS);
+}
+
+/**
+ * @brief Returns the gradient magnitude splitting the histogram into the two
+ *          classes with the largest between class variance (Otsu's method).
+ *
+ * @pre histogram has GMAG_HISTOGRAM_BINS bins
+ * @post no change to objects
+ *
+ * @param histogram histogram of the non zero magnitudes
+ * @return upper edge of the last bin of the lower class
+ */
+float otsuThreshold(const vector<int>& histogram) {
+
+  double total = 0;
+  double weighted_total = 0;
+  for (int bin = 0; bin < GMAG_HISTOGRAM_BINS; ++bin) {
+    total += histogram[bin];
+    weighted_total += (double)bin * histogram[bin];
+  }
+
+  double lower_count = 0;
+  double lower_weighted = 0;
+  double best_variance = -1;
+  int best_bin = 0;
+
+  // Try every split after bin, lower class is [0, bin]
+  for (int bin = 0; bin < GMAG_HISTOGRAM_BINS - 1; ++bin) {
+    lower_count += histogram[bin];
+    lower_weighted += (double)bin * histogram[bin];
+
+    double upper_count = total - lower_count;
+    if (lower_count == 0 || upper_count == 0) {
+      continue;
+    }
+
+    double mean_difference = lower_weighted / lower_count -
+                             (weighted_total - lower_weighted) / upper_count;
+    double variance =
+      lower_count * upper_count * mean_difference * mean_difference;
+    if (variance > best_variance) {
+      best_variance = variance;
+      best_bin = bin;
+    }
+  }
+
+  return (best_bin + 1) * (GMAG_HISTOGRAM_MAX / GMAG_HISTOGRAM_BINS);
+}
+
+/**
+ * @brief Finds the local maxima of the gradient magnitude using non maximum
+ *          suppression (STEP 8).
+ *
+ * @details The local maximum test along the gradient direction does not depend
+ *            on the threshold, so one maxima image serves every threshold at
+ *            or above min_threshold, see thresholdEdges.
+ *          A pixel q is a local maximum when:
+ *            -Gmag >= min_threshold
+ *            -Gmag > Gr
+ *            -Gmag > Gp
+ *          Given g is one pixel in the gradient direction given by:
+ *            g = (Gx / Gmag, Gy/Gmag), and
+ *            r is one pixel in the q direction and
+ *            p is one direction in the opposite direction of q, where
+ *              r = q + g   p = q - g
+ *
+ * @pre gx, gy and gmag are float images of the same dimensions, min_threshold
+ *        is greater than zero
+ * @post if edge_points is not nullptr it holds the local maxima in row major
+ *        order
+ *
+ * @param gx gradient image in the x direction
+ * @param gy gradient image in the y direction
+ * @param gmag gradient magnitude image
+ * @param min_threshold smallest gradient magnitude of a local maximum
+ * @param edge_points optional output list of local maxima
+ * @return float image holding Gmag at every local maximum and 0 elsewhere, or
+ *           an empty image when edge_points is not nullptr
+ */
+Image suppressNonMaxima(const Image& gx, const Image& gy, const Image& gmag,
+                        float min_threshold,
+                        vector<EdgePoint>* edge_points = nullptr) {
+
+  // Edge lists replace the dense maxima image
+  bool dense = edge_points == nullptr;
+  Image result_maxima = dense ? Image(gmag.getRows(), gmag.getCols())
+                              : Image();
 
-  // result_edge is the resultant edged image
-  Image result_edge(gmag.getRows(), gmag.getCols());
-
-  // For every point in result_edge
-  // Check in gmag with maximum suppression with conditions:
-  //  -Gmag >= 10
-  //  -Gmag > Gr
-  //  -Gmag > Gp
-  // Given g is one pixel in the gradient direction given by:
-  //  g = (Gx / Gmag, Gy/Gmag), and
-  //  r is one pixel in the q direction and
-  //  p is one direction in the opposite direction of q, where
-  //    r = q + g   p = q - g
   // for every row of gmag
   for (int row = 0; row < gmag.getRows(); ++row) {
 
     // for every column of gmag
     for (int col = 0; col < gmag.getCols(); ++col) {
 
-      // If magnitude of pixel in gmag at (row, col) is at least 10
-      if (gmag.getFloat(row, col) >= 10) {
+      float magnitude = gmag.getFloat(row, col);
+      bool is_local_max = false;
+      bool clamped = false;
+      EdgePoint edge = { row, col, magnitude, 0, 0 };
 
-        // Calculate g, one pixel in the gradient direction
-        float gx_over_gmag = gx.getFloat(row, col) / gmag.getFloat(row, col);
-        float gy_over_gmag = gy.getFloat(row, col) / gmag.getFloat(row, col);
+      // If magnitude of pixel in gmag at (row, col) meets some threshold
+      if (magnitude >= min_threshold) {
 
+        // Calculate g, one pixel in the gradient direction
+        float gx_over_gmag = gx.getFloat(row, col) / magnitude;
+        float gy_over_gmag = gy.getFloat(row, col) / magnitude;
 
         // Conditionals below ensure no pixel out of image queried, if out of
         // image pixel queried, pulls closets pixel in image
         float r_col = col + gx_over_gmag;
         if (r_col > gmag.getCols() - 1) {
           r_col = (float)(gmag.getCols() - 1);
+          clamped = true;
         } else if (r_col < 0) {
           r_col = 0;
+          clamped = true;
         }
 
         // Out of image conditional
         float r_row = row + gy_over_gmag;
         if (r_row > gmag.getRows() - 1) {
           r_row = (float)(gmag.getRows() - 1);
+          clamped = true;
         } else if (r_row < 0) {
           r_row = 0;
+          clamped = true;
         }
 
         // Out of image conditional
         float p_col = col - gx_over_gmag;
         if (p_col < 0) {
           p_col = 0;
+          clamped = true;
         } else if (p_col > gmag.getCols() - 1) {
           p_col = (float)(gmag.getCols() - 1);
+          clamped = true;
         }
 
         // Out of image conditional
         float p_row = row - gy_over_gmag;
         if (p_row < 0) {
           p_row = 0;
+          clamped = true;
         } else if (p_row > gmag.getRows() - 1) {
           p_row = (float)(gmag.getRows() - 1);
+          clamped = true;
         }
 
         // Interpolate the values for and p
         float r_val = interpolate(gmag, r_col, r_row).floatVal;
         float p_val = interpolate(gmag, p_col, p_row).floatVal;
-        
-        // Comparison to ensure non-maximum suppression, only largest value from
-        // gradient
-        // Set to max 255 if this is local max
-        if (gmag.getFloat(row, col) > r_val &&
-            gmag.getFloat(row, col) > p_val) {
-          result_edge.setFloat(row, col, 255);
-        } else {
-
-          // Sets to 0 if not max
-          result_edge.setFloat(row, col, 0);
+
+        // Comparison to ensure non-maximum suppression, only largest value
+        // from gradient
+        is_local_max = magnitude > r_val && magnitude > p_val;
+
+        // The gradient kernels are convolved, so g points toward darker
+        // pixels; the edge list records -g, the usual intensity gradient.
+        // Along -g the parabola passes through r (-1), q (0) and p (+1).
+        // Both neighbors are lower, so the curvature in the denominator is
+        // negative and the vertex lies in (-0.5, 0.5). When p or r was
+        // pulled back into the image they are not one pixel from q and the
+        // fit does not hold, so the offset stays 0.
+        if (is_local_max && edge_points != nullptr) {
+          edge.orientation = atan2(-gy_over_gmag, -gx_over_gmag);
+          if (!clamped) {
+            edge.offset =
+              (r_val - p_val) / (2 * (p_val - 2 * magnitude + r_val));
+          }
         }
+      }
 
-      } else {
-        
-        // Set to 0 if gradient magnitude does not meet threshhold
-        result_edge.setFloat(row, col, 0);
+      // Keep the magnitude of local maxima, 0 for every other pixel
+      if (dense) {
+        result_maxima.setFloat(row, col, is_local_max ? magnitude : 0.0f);
+      } else if (is_local_max) {
+        edge_points->push_back(edge);
       }
     }
   }
 
+  return result_maxima;
+}
+
+/**
+ * @brief Creates the byte edge image of one threshold from the local maxima
+ *          of suppressNonMaxima (STEP 8).
+ *
+ * @details An edge is marked (255) where the local maximum magnitude is at
+ *            least threshold, every other pixel is 0.
+ *
+ * @pre maxima was returned by suppressNonMaxima with a min_threshold of at
+ *        most threshold
+ * @post edge_count holds the number of edge pixels, no change to maxima
+ *
+ * @param maxima float image of local maximum magnitudes
+ * @param threshold minimum gradient magnitude for an edge
+ * @param edge_count output number of edge pixels
+ * @return byte edge image
+ */
+Image thresholdEdges(const Image& maxima, float threshold, int& edge_count) {
+
+  Image result_edges(maxima.getRows(), maxima.getCols());
+  edge_count = 0;
+
+  for (int row = 0; row < maxima.getRows(); ++row) {
+    for (int col = 0; col < maxima.getCols(); ++col) {
+      bool is_edge = maxima.getFloat(row, col) >= threshold;
+      if (is_edge) {
+        ++edge_count;
+      }
+      result_edges.setGrey(row, col, is_edge ? 255 : 0);
+    }
+  }
+
+  return result_edges;
+}
+
+/**
+ * @brief Writes edges as a compact binary edge list instead of a full image
+ *
+ * @details All values are stored in the byte order of the machine.
+ *          Header: "EDGL", then uint32 version (3), rows, cols, flags and
+ *            edge count. Flags bit 0 is set when records carry the subpixel
+ *            offset.
+ *          Record: uint16 row, uint16 col, float magnitude, float
+ *            orientation and, with subpixel, float offset, 12 or 16 bytes
+ *            without padding. GIF images are at most 65535 pixels on a side,
+ *            so the format assumes rows and cols of at most 65535.
+ *          Directions use x along +col and y along +row, so y points down
+ *            the image. orientation is the angle atan2(y, x) in radians, in
+ *            [-pi, pi], of the intensity gradient: it points from the darker
+ *            to the brighter side of the edge. A step that goes dark to
+ *            bright along +col has orientation 0.
+ *          offset is the signed subpixel distance, in pixels, from the pixel
+ *            center to the magnitude peak along orientation. It is 0 for
+ *            edges whose gradient neighbors fall outside the image.
+ *          Records are packed into a fixed size buffer that is flushed to
+ *            the file whenever it fills up.
+ *
+ * @pre filename refers to a valid location to store the list
+ * @post the edge list file is written, nothing is written when rows or cols
+ *         exceed 65535
+ *
+ * @param filename name of the file to write
+ * @param rows number of rows of the edge image
+ * @param cols number of columns of the edge image
+ * @param edges edge pixels to write
+ * @param subpixel true to include the subpixel offset of each edge
+ * @return true if the whole list was written
+ */
+bool writeEdgeList(const string& filename, int rows, int cols,
+                   const vector<EdgePoint>& edges, bool subpixel) {
+
+  // Positions are stored as uint16
+  if (rows > UINT16_MAX || cols > UINT16_MAX) {
+    return false;
+  }
+
+  ofstream out(filename.c_str(), ios::binary);
+  if (!out) {
+    return false;
+  }
+
+  uint32_t header[5] = { 3, (uint32_t)rows, (uint32_t)cols,
+                         subpixel ? 1u : 0u, (uint32_t)edges.size() };
+  out.write("EDGL", 4);
+  out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+  size_t record_bytes = subpixel ? 2 * 2 + 3 * 4 : 2 * 2 + 2 * 4;
+  vector<char> buffer(EDGE_LIST_BUFFER_BYTES - EDGE_LIST_BUFFER_BYTES %
+                      record_bytes);
+  size_t used = 0;
+
+  for (size_t e = 0; e < edges.size(); ++e) {
+    uint16_t position[2] = { (uint16_t)edges[e].row, (uint16_t)edges[e].col };
+    float values[3] = { edges[e].magnitude, edges[e].orientation,
+                        edges[e].offset };
+
+    memcpy(&buffer[used], position, sizeof(position));
+    memcpy(&buffer[used + sizeof(position)], values,
+           record_bytes - sizeof(position));
+    used += record_bytes;
+
+    // Flush the buffer once it is full
+    if (used == buffer.size()) {
+      out.write(buffer.data(), used);
+      used = 0;
+    }
+  }
+  out.write(buffer.data(), used);
+
+  return out.good();
+}
+
+/**
+ * @brief Runs every (iterations, threshold) configuration of a parameter sweep
+ *          and writes one edge image per configuration.
+ *
+ * @details Smoothing is computed incrementally: level k + 1 is level k smoothed
+ *            once more in X and Y instead of smoothing the original image
+ *            k + 1 times. Gradients and non maximum suppression are computed
+ *            once per level; each threshold then only compares the local
+ *            maxima against its value while its edge image is written, so
+ *            only one edge image is held at a time.
+ *          Each edge image is written to "edges_<iterations>_<threshold>.gif"
+ *            and the edge pixel counts are written to "sweep.csv" and printed
+ *            as a grid of iterations by threshold.
+ *
+ * @pre img holds float values, 0 <= min_iterations <= max_iterations,
+ *        thresholds is not empty and every threshold is greater than zero
+ * @post writes the edge images and sweep.csv, no change to img
+ *
+ * @param img input float image
+ * @param min_iterations smallest number of smoothing iterations to evaluate
+ * @param max_iterations largest number of smoothing iterations to evaluate
+ * @param thresholds edge thresholds to evaluate at every smoothing level
+ */
+void runParameterSweep(const Image& img, int min_iterations,
+                       int max_iterations, const vector<float>& thresholds) {
+
+  int pixel_count = img.getRows() * img.getCols();
+  ofstream summary("sweep.csv");
+  summary << "iterations,threshold,edge_pixels,edge_fraction" << endl;
+
+  // Grid header, one column per threshold
+  std::cout << setw(10) << "iter\\thr";
+  for (size_t t = 0; t < thresholds.size(); ++t) {
+    std::cout << setw(10) << thresholds[t];
+  }
+  std::cout << endl;
+
+  // Pixels below the smallest threshold cannot be an edge in any image
+  float min_threshold = thresholds[0];
+  for (size_t t = 1; t < thresholds.size(); ++t) {
+    if (thresholds[t] < min_threshold) {
+      min_threshold = thresholds[t];
+    }
+  }
+
+  // Level 0 is the unsmoothed image
+  Image level(img);
+
+  for (int k = 0; k <= max_iterations; ++k) {
+
+    // Advance the smoothing by one level from the previous level
+    if (k > 0) {
+      level = smoothImage(level, 1);
+    }
+
+    if (k < min_iterations) {
+      continue;
+    }
+
+    Image gx;
+    Image gy;
+    computeGradients(level, gx, gy);
+    Image gmag = computeGradientMagnitude(gx, gy);
+
+    Image maxima = suppressNonMaxima(gx, gy, gmag, min_threshold);
+
+    std::cout << setw(10) << k;
+    for (size_t t = 0; t < thresholds.size(); ++t) {
+      int edge_count = 0;
+      Image edges = thresholdEdges(maxima, thresholds[t], edge_count);
+
+      ostringstream filename;
+      filename << "edges_" << k << "_" << thresholds[t] << ".gif";
+      writeGreyGifImage(edges, filename.str());
+
+      summary << k << "," << thresholds[t] << "," << edge_count << ","
+              << (pixel_count > 0 ? (double)edge_count / pixel_count : 0.0)
+              << endl;
+      std::cout << setw(10) << edge_count;
+    }
+    std::cout << endl;
+  }
+}
+
+/**
+ * @brief Runs STEPS 3 through 8 on one input image
+ *
+ * @pre img was read from a file and holds grey values
+ * @post img holds the smoothed float image, result holds the outputs
+ *
+ * @param img input image, converted to float and smoothed in place
+ * @param options settings of the run
+ * @param result receives the smoothed image, edges and threshold
+ */
+void detectEdges(Image& img, const EdgeOptions& options, EdgeResult& result) {
+
+  // STEP 3 FLOATING POINT IMG--------------------------------------------------
+  // Convert image pixel RGB to float
+  convertImageToFloat(img);
+
+  // STARTING IMAGE AS FLOAT
+  // Test image for after image converted to float
+  //img.writeFloatImage("before_smooth.gif");
+
+  // STEP 4 SMOOTH i times in X and Y directions--------------------------------
+  // Smooth with the hard coded 1/4, 1/2, 1/4 Gaussian for options.iterations
+  // number of iterations to the output image
+  img = smoothImage(img, options.iterations);
+
+  // STEP 5 Intermediary, Convert to bytes for smooth.gif-----------------------
+  result.smooth = createByteImage(img);
+
+  // STEP 6 Calculate gradient in X and gradient in Y---------------------------
+  Image gx;
+  Image gy;
+  computeGradients(img, gx, gy);
+
+  // GX and GY float images for testing
+  //gx.writeFloatImage("gx.gif");
+  //gy.writeFloatImage("gy.gif");
+
+  // Print after_gx image and after_gy image for testing
+  //Image after_gx = createByteImage(gx);
+  //Image after_gy = createByteImage(gy);
+  //after_gx.writeGreyImage("after_gx.gif");
+  //after_gy.writeGreyImage("after_gy.gif");
+
+  // STEP 7 Gradient Magnitude--------------------------------------------------
+  // Set gmag to the calculation of gx and gy
+  // sqrt( (gx)^2 + (gy)^2 )
+  // Adaptive thresholds also need the histogram of the magnitudes
+  bool adaptive_threshold = options.otsu || options.percentile >= 0;
+  vector<int> gmag_histogram;
+  Image gmag = computeGradientMagnitude(
+    gx, gy, adaptive_threshold ? &gmag_histogram : nullptr,
+    options.magnitude_threads);
+
+  result.threshold = options.threshold;
+  if (options.otsu) {
+    result.threshold = otsuThreshold(gmag_histogram);
+  } else if (options.percentile >= 0) {
+    result.threshold = percentileThreshold(gmag_histogram, options.percentile);
+  }
+
+  // Print after_gmag image for testing
+  //gmag.writeFloatImage("gmag.gif");
+
+  // Step 8 Edge Image----------------------------------------------------------
+  // result.edges holds the resultant edged image with the chosen threshold,
+  // or nothing when only the edge list is wanted
+  if (options.edge_list) {
+    suppressNonMaxima(gx, gy, gmag, result.threshold, &result.edge_points);
+    result.edge_count = (int)result.edge_points.size();
+  } else {
+    Image maxima = suppressNonMaxima(gx, gy, gmag, result.threshold);
+    result.edges = thresholdEdges(maxima, result.threshold, result.edge_count);
+  }
+}
+
+/**
+ * @brief Writes the outputs of detectEdges (STEPS 5 and 9)
+ *
+ * @pre result was filled by detectEdges with the same options
+ * @post the smoothed image and the edge image or edge list are written
+ *
+ * @param result outputs of the run
+ * @param options settings of the run
+ * @param smooth_filename file to write the smoothed image to
+ * @param edges_filename file to write the edge image or edge list to
+ * @return true if the outputs were written
+ */
+bool writeEdgeResult(const EdgeResult& result, const EdgeOptions& options,
+                     const string& smooth_filename,
+                     const string& edges_filename) {
+
+  // STEP 5 Intermediary print smooth.gif
+  if (!writeGreyGifImage(result.smooth, smooth_filename,
+                         options.gif_compression)) {
+    return false;
+  }
+
   // Step 9 Print out Edge Image------------------------------------------------
-  result_edge = createByteImage(result_edge);
-  result_edge.writeGreyImage("edges.gif");
+  if (options.edge_list) {
+    return writeEdgeList(edges_filename, result.smooth.getRows(),
+                         result.smooth.getCols(), result.edge_points,
+                         options.subpixel);
+  }
+  return writeGreyGifImage(result.edges, edges_filename,
+                           options.gif_compression);
+}
+
+/**
+ * @brief Returns filename with its extension replaced by suffix
+ *
+ * @param filename input file name, may include a directory
+ * @param suffix text to append in place of the extension
+ * @return output file name next to the input file
+ */
+string outputFilename(const string& filename, const string& suffix) {
+  size_t dot = filename.find_last_of('.');
+  size_t slash = filename.find_last_of("/\\");
+  if (dot == string::npos || (slash != string::npos && dot < slash)) {
+    return filename + suffix;
+  }
+  return filename.substr(0, dot) + suffix;
+}
+
+/**
+ * @brief Runs edge detection on many images with decode, compute and encode
+ *          stages running concurrently.
+ *
+ * @details Decode threads read inputs and push them to the compute queue,
+ *            compute threads run detectEdges and push to the encode queue,
+ *            and encode threads write the outputs. The queues are bounded and
+ *            lock-free; a stage waits when the queue it pushes to is full, so
+ *            at most a few images are in memory and throughput follows the
+ *            slowest stage instead of the sum of the stages.
+ *          GIFs are read and written with GifCodec, which keeps no shared
+ *            state, so decode and encode threads run without a lock.
+ *          Every stage handles exactly inputs.size() images, so workers stop
+ *            once all images of their stage have been claimed.
+ *          Outputs are written next to each input as <name>_smooth.gif and
+ *            <name>_edges.gif, or <name>_edges.bin with an edge list.
+ *
+ * @pre thread counts and queue_size are at least one
+ * @post outputs of every readable input are written
+ *
+ * @param inputs names of the GIF images to process
+ * @param options settings applied to every image
+ * @param decode_threads number of threads reading images
+ * @param compute_threads number of threads running detectEdges
+ * @param encode_threads number of threads writing outputs
+ * @param queue_size capacity of each queue between stages
+ * @return number of images that failed
+ */
+int runImagePipeline(const vector<string>& inputs, const EdgeOptions& options,
+                     int decode_threads, int compute_threads,
+                     int encode_threads, size_t queue_size) {
+
+  // One job per input, queues pass job indices between stages
+  struct ImageJob {
+    Image img;
+    EdgeResult result;
+    bool ok = false;
+  };
+  vector<ImageJob> jobs(inputs.size());
+  BoundedQueue<int> compute_queue(queue_size);
+  BoundedQueue<int> encode_queue(queue_size);
+
+  // Next job each stage hands out to its workers
+  atomic<int> next_decode(0);
+  atomic<int> next_compute(0);
+  atomic<int> next_encode(0);
+  atomic<int> failures(0);
+  int job_count = (int)jobs.size();
+
+  auto decode = [&]() {
+    for (int job = next_decode++; job < job_count; job = next_decode++) {
+      jobs[job].ok = readGifImage(inputs[job], jobs[job].img);
+      compute_queue.push(job);
+    }
+  };
+
+  auto compute = [&]() {
+    while (next_compute++ < job_count) {
+      int job = compute_queue.pop();
+      if (jobs[job].ok) {
+        detectEdges(jobs[job].img, options, jobs[job].result);
+      }
+
+      // Release the float image before it waits in the encode queue
+      jobs[job].img = Image();
+      encode_queue.push(job);
+    }
+  };
+
+  auto encode = [&]() {
+    while (next_encode++ < job_count) {
+      int job = encode_queue.pop();
+      ostringstream message;
+      string edges_suffix = options.edge_list ? "_edges.bin" : "_edges.gif";
+
+      if (jobs[job].ok &&
+          writeEdgeResult(jobs[job].result, options,
+                          outputFilename(inputs[job], "_smooth.gif"),
+                          outputFilename(inputs[job], edges_suffix))) {
+        message << inputs[job] << ": threshold " << jobs[job].result.threshold
+                << ", " << jobs[job].result.edge_count << " edge pixels"
+                << endl;
+      } else {
+        message << inputs[job] << ": failed" << endl;
+        ++failures;
+      }
+      std::cout << message.str();
+
+      // Release the outputs once written
+      jobs[job].result = EdgeResult();
+    }
+  };
+
+  auto start = chrono::steady_clock::now();
+
+  vector<thread> threads;
+  for (int t = 0; t < decode_threads; ++t) {
+    threads.push_back(thread(decode));
+  }
+  for (int t = 0; t < compute_threads; ++t) {
+    threads.push_back(thread(compute));
+  }
+  for (int t = 0; t < encode_threads; ++t) {
+    threads.push_back(thread(encode));
+  }
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  std::cout << job_count << " images in " << elapsed.count() << " s" << endl;
+
+  return failures;
+}
+
+/**
+ * @brief main method drives program through 9 nine steps which take an input
+ *          image, smoothes the image, prints out the smoothed image, creates
+ *          edge detection gradient images in x and y direction, combine the
+ *          gradient images, and creates an edge image based on the created
+ *          magnitude given threshold and maximus suppression.
+ * 
+ * @detail 
+ *    STEP 1: INPUT IN
+ *    STEP 2: Initialize test2.gif
+ *    STEP 3: Create floating point image
+ *    STEP 4: Smooth image argv[1] times
+ *    STEP 5: Intermediary printing of smooth.gif
+ *    STEP 6: Create gx and gy gradient images
+ *    STEP 7: Combine gx and gy gradient images into gmag image
+ *    STEP 8: Edge gmag image based on interpolated threshold
+ *    STEP 9: Output image
+ *
+ *    STEP 8 uses threshold 10 unless --threshold <value>, --percentile <p>
+ *    (percentile of the non zero magnitudes) or --otsu choose it. Only one of
+ *    the three may be given.
+ *
+ *    With --edge-list STEP 9 writes edges.bin, see writeEdgeList, instead of
+ *    edges.gif. --subpixel adds the subpixel offset of each edge.
+ *
+ *    --gif-compression best|none trades the size of the written GIFs for
+ *    encoding speed, see GifCompression.
+ *
+ *    With --batch <images...> STEPS 2 through 9 run for every listed image in
+ *    a pipeline, see runImagePipeline. --decode-threads, --compute-threads,
+ *    --encode-threads and --queue-size size its stages.
+ *
+ *    With argv[1] == "sweep" STEPS 4 through 9 are replaced by a parameter
+ *    sweep over a range of smoothing iterations and thresholds, see
+ *    runParameterSweep.
+ * 
+ * @pre Program must run with input argv[1] which gives n number of smoothing
+ *        "test2.gif" must be present in the directory unless --batch is used
+ * @post Prints out 2 images, smooth.gif and edges.gif
+ * 
+ * @param argc input counter
+ * @param argv input array, [1] containing program name [2] containing n number
+ *          of desired smoothing iterations, followed by the optional
+ *          --threshold, --percentile, --otsu, --edge-list, --subpixel,
+ *          --gif-compression and --batch flags, or
+ *          sweep <min iterations> <max iterations> <min threshold>
+ *          <max threshold> <threshold step>
+ * @return 0 if normal exit
+ */
+int main(int argc, char* argv[]) {
+
+  // STEP 1 INPUT IN------------------------------------------------------------
+  // If not enough argument provided
+  if (argc < 2) {
+    std::cout << "Did not provide number of iterations as an argument." << endl;
+    return -1;
+  }
+
+  // Sweep mode needs iteration and threshold ranges
+  bool sweep_mode = string(argv[1]) == "sweep";
+  if (sweep_mode && argc < 7) {
+    std::cout << "Usage: sweep <min iterations> <max iterations> "
+              << "<min threshold> <max threshold> <threshold step>" << endl;
+    return -1;
+  }
+
+  // Optional flags after the number of iterations
+  EdgeOptions options;
+  bool batch_mode = false;
+  vector<string> batch_inputs;
+  int decode_threads = 1;
+  int compute_threads = (int)thread::hardware_concurrency();
+  int encode_threads = 1;
+  int queue_size = 4;
+
+  // hardware_concurrency is 0 when the number of cores is unknown
+  if (compute_threads < 1) {
+    compute_threads = 1;
+  }
+
+  // Number of --threshold, --percentile and --otsu flags given
+  int threshold_flags = 0;
+
+  for (int arg = 2; !sweep_mode && arg < argc; ++arg) {
+    string flag = argv[arg];
+    if (flag == "--threshold" || flag == "--percentile" || flag == "--otsu") {
+      ++threshold_flags;
+    }
+
+    if (string(argv[arg]) == "--threshold" && arg + 1 < argc) {
+      options.threshold = stof(argv[++arg]);
+      if (options.threshold <= 0) {
+        std::cout << "Threshold must be greater than zero." << endl;
+        return -1;
+      }
+    } else if (string(argv[arg]) == "--percentile" && arg + 1 < argc) {
+      options.percentile = stof(argv[++arg]);
+      if (options.percentile < 0 || options.percentile > 100) {
+        std::cout << "Percentile must be between 0 and 100." << endl;
+        return -1;
+      }
+    } else if (string(argv[arg]) == "--otsu") {
+      options.otsu = true;
+    } else if (string(argv[arg]) == "--edge-list") {
+      options.edge_list = true;
+    } else if (string(argv[arg]) == "--subpixel") {
+      options.subpixel = true;
+    } else if (string(argv[arg]) == "--gif-compression" && arg + 1 < argc) {
+      string compression = argv[++arg];
+      if (compression == "best") {
+        options.gif_compression = GIF_COMPRESS_BEST;
+      } else if (compression == "none") {
+        options.gif_compression = GIF_COMPRESS_NONE;
+      } else {
+        std::cout << "GIF compression must be best or none." << endl;
+        return -1;
+      }
+    } else if (string(argv[arg]) == "--decode-threads" && arg + 1 < argc) {
+      decode_threads = stoi(argv[++arg]);
+    } else if (string(argv[arg]) == "--compute-threads" && arg + 1 < argc) {
+      compute_threads = stoi(argv[++arg]);
+    } else if (string(argv[arg]) == "--encode-threads" && arg + 1 < argc) {
+      encode_threads = stoi(argv[++arg]);
+    } else if (string(argv[arg]) == "--queue-size" && arg + 1 < argc) {
+      queue_size = stoi(argv[++arg]);
+    } else if (string(argv[arg]) == "--batch") {
+
+      // Every remaining argument is an input image
+      batch_mode = true;
+      batch_inputs.assign(argv + arg + 1, argv + argc);
+      break;
+    } else {
+      std::cout << "Unknown option " << argv[arg] << endl;
+      return -1;
+    }
+  }
+
+  // Only one way of choosing the threshold may be given
+  if (threshold_flags > 1) {
+    std::cout << "Use only one of --threshold, --percentile and --otsu."
+              << endl;
+    return -1;
+  }
+
+  // BATCH MODE Pipeline every listed image-------------------------------------
+  if (batch_mode) {
+    if (batch_inputs.empty()) {
+      std::cout << "Usage: <iterations> [options] --batch <images...>" << endl;
+      return -1;
+    }
+    if (decode_threads < 1 || compute_threads < 1 || encode_threads < 1 ||
+        queue_size < 1) {
+      std::cout << "Thread counts and queue size must be at least one." << endl;
+      return -1;
+    }
+    options.iterations = stoi(argv[1]);
+
+    // Share the cores between the compute threads
+    options.magnitude_threads =
+      (int)thread::hardware_concurrency() / compute_threads;
+    if (options.magnitude_threads < 1) {
+      options.magnitude_threads = 1;
+    }
+
+    return runImagePipeline(batch_inputs, options, decode_threads,
+                            compute_threads, encode_threads,
+                            (size_t)queue_size) == 0 ? 0 : -1;
+  }
+
+  // Ends program is test2.gif is not found in the directory
+  if (!fileIsInDirectory("test2.gif")) {
+    std::cout << "File test2.gif was not found" << endl;
+    return -1;
+  }
+
+  // STEP 2 test2.gif-----------------------------------------------------------
+  // Initialize input image in local directory within program
+  Image img;
+  if (!readGifImage("test2.gif", img)) {
+    std::cout << "File test2.gif is not a readable GIF" << endl;
+    return -1;
+  }
+
+  // SWEEP MODE Evaluate every configuration reusing smoothing levels----------
+  if (sweep_mode) {
+    int min_iterations = stoi(argv[2]);
+    int max_iterations = stoi(argv[3]);
+    float min_threshold = stof(argv[4]);
+    float max_threshold = stof(argv[5]);
+    float threshold_step = stof(argv[6]);
+
+    if (min_iterations < 0 || max_iterations < min_iterations ||
+        min_threshold <= 0 || max_threshold < min_threshold ||
+        threshold_step <= 0) {
+      std::cout << "Invalid sweep ranges." << endl;
+      return -1;
+    }
+
+    // Build thresholds by index to avoid accumulating the step error
+    vector<float> thresholds;
+    for (int t = 0; min_threshold + t * threshold_step <= max_threshold; ++t) {
+      thresholds.push_back(min_threshold + t * threshold_step);
+    }
+
+    // STEP 3 FLOATING POINT IMG
+    convertImageToFloat(img);
+
+    runParameterSweep(img, min_iterations, max_iterations, thresholds);
+    return 0;
+  }
+
+  // STEPS 3 through 8
+  options.iterations = stoi(argv[1]);
+  EdgeResult result;
+  detectEdges(img, options, result);
+
+  if (options.otsu || options.percentile >= 0) {
+    std::cout << "Edge threshold: " << result.threshold << endl;
+  }
+
+  // STEPS 5 and 9 Print out smooth.gif and the Edge Image
+  string edges_filename = options.edge_list ? "edges.bin" : "edges.gif";
+  if (!writeEdgeResult(result, options, "smooth.gif", edges_filename)) {
+    std::cout << "Could not write " << edges_filename << endl;
+    return -1;
+  }
   
   return 0; // Normal exit code
 }
\ No newline at end of file